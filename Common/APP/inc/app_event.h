@@ -11,6 +11,13 @@
 #define EVENT_APP_NOTIFICATION        (EVENT_APP_BASE + 5)
 #define EVENT_APP_LED_NOTIFICATION    (EVENT_APP_BASE + 6)
 #define EVENT_APP_BATTERY_NOTIFICATION    (EVENT_APP_BASE + 7)
+/* Internal use, wakes the key gesture engine to drain its edges and deadlines, no parameters. */
+#define EVENT_APP_KEY_GESTURE_WAKEUP  (EVENT_APP_BASE + 8)
+#ifdef APP_EVENT_SHARD_ENABLE
+#ifndef APP_EVENT_SHARD_NUM
+#define APP_EVENT_SHARD_NUM           (2)
+#endif
+#endif
 #define APP_ACTION_PLAY            (SRV_ACTION_USER_START)
 #define APP_ACTION_PAUSE           (SRV_ACTION_USER_START + 1)
 #define APP_ACTION_NEXT_TRACK      (SRV_ACTION_USER_START + 2)
@@ -37,6 +44,9 @@ typedef struct {
     srv_event_t event_id;
     void *parameters;
     app_event_post_result_t post_callback;
+#ifdef APP_EVENT_SHARD_ENABLE
+    bool control;    /* Internal use, the event carries a subscriber list request. */
+#endif
 } app_event_t;
 typedef struct {
     app_event_node_t pointer;
@@ -44,11 +54,31 @@ typedef struct {
     app_event_callback_t callback;
     bool dirty;
 } app_event_callback_node_t;
+/**
+ *  @brief Per-shard dispatcher statistics, posted and dropped are updated by the posting tasks.
+ */
+typedef struct {
+    uint32_t posted;
+    uint32_t dropped;
+    uint32_t processed;
+    uint32_t max_pending;
+} app_event_shard_stats_t;
 void app_event_init(void);
-void app_event_post(srv_event_t event_id, void *parameters, app_event_post_result_t callback);
-void app_event_register_callback(srv_event_t event_id, app_event_callback_t callback);
-void app_event_deregister_callback(srv_event_t event_id, app_event_callback_t callback);
+srv_status_t app_event_post(srv_event_t event_id, void *parameters, app_event_post_result_t callback);
+srv_status_t app_event_post_from_isr(srv_event_t event_id, void *parameters);
+srv_status_t app_event_register_callback(srv_event_t event_id, app_event_callback_t callback);
+srv_status_t app_event_deregister_callback(srv_event_t event_id, app_event_callback_t callback);
+#ifndef APP_EVENT_SHARD_ENABLE
 void app_event_process(app_event_t *event);
+#endif
 srv_status_t app_event_handler(srv_event_t event_id, void *parameters);
 void app_event_post_callback(srv_event_t event_id, srv_status_t result, void *parameters);
+#ifdef APP_EVENT_SHARD_ENABLE
+/* The callback may run on every shard at the same time, it must not touch unguarded shared state. */
+srv_status_t app_event_register_shard_callback(srv_event_t event_id, app_event_callback_t callback);
+srv_status_t app_event_deregister_shard_callback(srv_event_t event_id, app_event_callback_t callback);
+srv_status_t app_event_post_with_key(srv_event_t event_id, uint32_t affinity_key, void *parameters, app_event_post_result_t callback);
+void app_event_shard_loop(uint32_t shard_index);
+srv_status_t app_event_shard_get_stats(uint32_t shard_index, app_event_shard_stats_t *stats);
+#endif
 #endif
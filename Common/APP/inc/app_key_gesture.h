@@ -0,0 +1,46 @@
+#ifndef APP_KEY_GESTURE_H
+#define APP_KEY_GESTURE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "srv.h"
+#include "app_event.h"
+
+#define APP_KEY_GESTURE_KEY_NUM               (SRV_KEY_VOL_UP + 1)
+#define APP_KEY_GESTURE_EDGE_QUEUE_SIZE       (16)
+#define APP_KEY_GESTURE_LONG_PRESS_TIME       (2000)
+#define APP_KEY_GESTURE_LONG_LONG_PRESS_TIME  (5000)
+#define APP_KEY_GESTURE_VERY_LONG_PRESS_TIME  (10000)
+#define APP_KEY_GESTURE_MULTI_CLICK_TIME      (300)
+#define APP_KEY_GESTURE_MAX_CLICKS            (3)
+
+/**
+    *  @brief Per key thresholds, all times are in ms.
+*/
+typedef struct {
+    uint32_t long_press_time;       /**< Hold time to report long press, 0 disables all long press levels. */
+    uint32_t long_long_press_time;  /**< Hold time to report long long press, 0 disables it and the levels after. */
+    uint32_t very_long_press_time;  /**< Hold time to report very long press, 0 disables it. */
+    uint32_t multi_click_time;      /**< Max gap between a release and the next press of a double or triple click. */
+    uint8_t  max_clicks;            /**< 1 reports press up at release without waiting, 2 or 3 enables double and triple click. */
+} app_key_gesture_config_t;
+
+/**
+    *  @brief Per key statistics, latency is the time from the deciding edge or threshold to the action post.
+*/
+typedef struct {
+    uint32_t emitted;
+    uint32_t dropped;
+    uint32_t last_latency;
+    uint32_t max_latency;
+} app_key_gesture_stats_t;
+
+void app_key_gesture_init(void);
+srv_status_t app_key_gesture_set_config(srv_key_value_t key_value, const app_key_gesture_config_t *config);
+/* timestamp is in ms on the same base as xTaskGetTickCount() * portTICK_PERIOD_MS.
+ * SRV_STATUS_FAIL when the edge is dropped, or when neither the wakeup event nor the timer retry could be queued,
+ * an edge queued in that case waits for the next wakeup. */
+srv_status_t app_key_gesture_edge(srv_key_value_t key_value, bool pressed, uint32_t timestamp);
+srv_status_t app_key_gesture_edge_from_isr(srv_key_value_t key_value, bool pressed, uint32_t timestamp);
+srv_status_t app_key_gesture_get_stats(srv_key_value_t key_value, app_key_gesture_stats_t *stats);
+srv_status_t app_key_gesture_event_handler(srv_event_t event_id, void *parameters);
+#endif
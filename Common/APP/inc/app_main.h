@@ -19,6 +19,19 @@
 #define APP_DEVICE_SLAVE       (0x01)
 typedef uint8_t app_device_role_t;
 
+#ifdef APP_EVENT_SHARD_ENABLE
+/**
+    *  @brief One dispatcher of the sharded event system, every shard owns its queue and subscriber list.
+*/
+typedef struct {
+    QueueHandle_t       queue_handle;
+    TaskHandle_t        task_handle;
+    app_event_node_t    dynamic_callback_header;
+    srv_event_t         invoking;
+    app_event_shard_stats_t stats;
+} app_event_shard_t;
+#endif
+
 typedef struct {
     QueueHandle_t       queue_handle;
     srv_state_t         state;
@@ -28,6 +41,9 @@ typedef struct {
     uint8_t             battery_level;
     srv_features_config_t feature_config;
     bool notify_connection_state;
+#ifdef APP_EVENT_SHARD_ENABLE
+    app_event_shard_t   shard[APP_EVENT_SHARD_NUM];
+#endif
 } app_context_t;
 
 extern app_context_t app_context;
@@ -1,5 +1,8 @@
 #include "FreeRTOS.h"
 #include "task.h"
+#ifdef APP_EVENT_SHARD_ENABLE
+#include "semphr.h"
+#endif
 #include "bt_sink_app_main.h"
 //
 static void app_event_node_init(app_event_node_t *event_node)
@@ -35,13 +38,99 @@ static app_event_callback_node_t *app_event_node_find_callback(app_event_node_t
     }
     return result;
 }
+#ifdef APP_EVENT_SHARD_ENABLE
+/* Subscriber list request, carried by a control event to the dispatcher owning the list. */
+typedef struct {
+    bool subscribe;
+    srv_event_t event_id;
+    app_event_callback_t callback;
+    app_event_callback_node_t *node;
+    SemaphoreHandle_t done;
+} app_event_shard_request_t;
+static void app_event_shard_task(void *arg)
+{
+    app_event_shard_loop((uint32_t)(uintptr_t)arg);
+    vTaskDelete(NULL);
+}
+static void app_event_shard_init(void)
+{
+    uint32_t i;
+    app_event_shard_t *shard;
+    for (i = 0; i < APP_EVENT_SHARD_NUM; i++) {
+        shard = &app_context.shard[i];
+        memset(shard, 0, sizeof(app_event_shard_t));
+        shard->invoking = SRV_EVENT_ALL;
+        app_event_node_init(&shard->dynamic_callback_header);
+        shard->queue_handle = xQueueCreate(APP_QUEUE_SIZE, sizeof(app_event_t));
+        if (NULL == shard->queue_handle) {
+            app_report("[Sink][Fatal Error] shard:%d queue create fail", i);
+        }
+    }
+    // shard 0 is served by the calling app task, the others match it as created by app_task_create
+    app_context.queue_handle = app_context.shard[0].queue_handle;
+    app_context.shard[0].task_handle = xTaskGetCurrentTaskHandle();
+    for (i = 1; i < APP_EVENT_SHARD_NUM; i++) {
+        shard = &app_context.shard[i];
+        if (NULL == shard->queue_handle) {
+            continue;
+        }
+        if (pdPASS != xTaskCreate(app_event_shard_task,
+                                  "app_shard",
+                                  APP_TASK_STACKSIZE / ((uint32_t)sizeof(StackType_t)),
+                                  (void *)(uintptr_t)i,
+                                  APP_TASK_PRIO,
+                                  &shard->task_handle)) {
+            shard->task_handle = NULL;
+            app_report("[Sink][Fatal Error] shard task create fail:%d", i);
+        }
+    }
+#if (configUSE_CORE_AFFINITY == 1) && (configNUMBER_OF_CORES > 1)
+    for (i = 0; i < APP_EVENT_SHARD_NUM; i++) {
+        if (NULL != app_context.shard[i].task_handle) {
+            vTaskCoreAffinitySet(app_context.shard[i].task_handle, (UBaseType_t)(1 << (i % configNUMBER_OF_CORES)));
+        }
+    }
+#endif
+}
+static srv_status_t app_event_shard_post(uint32_t shard_index, srv_event_t event_id, void *parameters, app_event_post_result_t callback)
+{
+    app_event_shard_t *shard = &app_context.shard[shard_index];
+    app_event_t event;
+    memset(&event, 0, sizeof(app_event_t));
+    event.event_id = event_id;
+    event.parameters = parameters;
+    event.post_callback = callback;
+    if (shard->queue_handle == NULL) {
+        app_report("[Sink] shard:%d queue is not ready.", shard_index);
+        return SRV_STATUS_FAIL;
+    }
+    if (pdPASS != xQueueSend(shard->queue_handle, &event, 0)) {
+        __atomic_fetch_add(&shard->stats.dropped, 1, __ATOMIC_RELAXED);
+        if (NULL != callback) {
+            callback(event_id, SRV_STATUS_FAIL, parameters);
+        }
+        app_report("[Sink][Fatal Error] shard:%d event lost:0x%x", shard_index, event_id);
+        return SRV_STATUS_FAIL;
+    }
+    __atomic_fetch_add(&shard->stats.posted, 1, __ATOMIC_RELAXED);
+    return SRV_STATUS_SUCCESS;
+}
+#endif
 void app_event_init(void)
 {
     app_context.invoking =  SRV_EVENT_ALL;
     app_event_node_init(&   app_context.dynamic_callback_header);
+#ifdef APP_EVENT_SHARD_ENABLE
+    app_event_shard_init();
+#endif
 }
-void app_event_post(srv_event_t event_id, void *parameters, app_event_post_result_t callback)
+srv_status_t app_event_post(srv_event_t event_id, void *parameters, app_event_post_result_t callback)
 {
+#ifdef APP_EVENT_SHARD_ENABLE
+    app_report("[Sink] bt_sink_app_event_post, event:%x", event_id);
+    // shard 0 keeps the single queue order of all the events posted without a key
+    return app_event_shard_post(0, event_id, parameters, callback);
+#else
     app_event_t event;
     app_report("[Sink] bt_sink_app_event_post, event:%x", event_id);
     memset(&event, 0, sizeof(bt_sink_app_event_t));
@@ -50,38 +139,84 @@ void app_event_post(srv_event_t event_id, void *parameters, app_event_post_resul
     event.post_callback = callback;
     if (app_context.queue_handle == NULL) {
         app_report("[Sink] queue is not ready.");
-        return;
+        return SRV_STATUS_FAIL;
     }
     if (pdPASS != xQueueSend(app_context.queue_handle, &event, 0)) {
         if (NULL != callback) {
             callback(event_id, SRV_STATUS_FAIL, parameters);
         }
         app_report("[Sink][Fatal Error] event lost:0x%x", event_id);
+        return SRV_STATUS_FAIL;
     }
+    return SRV_STATUS_SUCCESS;
+#endif
+}
+#ifdef APP_EVENT_SHARD_ENABLE
+srv_status_t app_event_post_with_key(srv_event_t event_id, uint32_t affinity_key, void *parameters, app_event_post_result_t callback)
+{
+    app_report("[Sink] app_event_post_with_key, event:%x key:%x", event_id, affinity_key);
+    return app_event_shard_post(affinity_key % APP_EVENT_SHARD_NUM, event_id, parameters, callback);
 }
-void app_event_register_callback(srv_event_t event_id, app_event_callback_t callback)
+#endif
+srv_status_t app_event_post_from_isr(srv_event_t event_id, void *parameters)
+{
+    app_event_t event;
+    QueueHandle_t queue_handle;
+    BaseType_t higher_priority_task_woken = pdFALSE;
+#ifdef APP_EVENT_SHARD_ENABLE
+    app_event_shard_t *shard = &app_context.shard[0];
+    queue_handle = shard->queue_handle;
+#else
+    queue_handle = app_context.queue_handle;
+#endif
+    // no log and no post callback in interrupt context
+    memset(&event, 0, sizeof(app_event_t));
+    event.event_id = event_id;
+    event.parameters = parameters;
+    if (queue_handle == NULL) {
+        return SRV_STATUS_FAIL;
+    }
+    if (pdPASS != xQueueSendFromISR(queue_handle, &event, &higher_priority_task_woken)) {
+#ifdef APP_EVENT_SHARD_ENABLE
+        __atomic_fetch_add(&shard->stats.dropped, 1, __ATOMIC_RELAXED);
+#endif
+        return SRV_STATUS_FAIL;
+    }
+#ifdef APP_EVENT_SHARD_ENABLE
+    __atomic_fetch_add(&shard->stats.posted, 1, __ATOMIC_RELAXED);
+#endif
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+    return SRV_STATUS_SUCCESS;
+}
+#ifndef APP_EVENT_SHARD_ENABLE
+static srv_status_t app_event_list_register(app_event_node_t *head, srv_event_t event_id, app_event_callback_t callback)
 {
     app_event_callback_node_t *callback_node =
-        app_event_node_find_callback(&app_context.dynamic_callback_header, event_id, callback);
+        app_event_node_find_callback(head, event_id, callback);
     if (NULL == callback_node) {
         callback_node = (app_event_callback_node_t *)pvPortMalloc(sizeof(*callback_node));
-        if (NULL != callback_node) {
-            memset(callback_node, 0, sizeof(app_event_callback_node_t));
-            callback_node->event_id = event_id;
-            callback_node->callback = callback;
-            app_event_node_insert(&app_context.dynamic_callback_header, &callback_node->pointer);
+        if (NULL == callback_node) {
+            return SRV_STATUS_FAIL;
         }
+        memset(callback_node, 0, sizeof(app_event_callback_node_t));
+        callback_node->event_id = event_id;
+        callback_node->callback = callback;
+        app_event_node_insert(head, &callback_node->pointer);
     } else {
         callback_node->dirty = false;
     }
+    return SRV_STATUS_SUCCESS;
 }
-void app_event_deregister_callback(srv_event_t event_id, app_event_callback_t callback)
+#endif
+static void app_event_list_deregister(app_event_node_t *head, srv_event_t invoking,
+        srv_event_t event_id, app_event_callback_t callback)
 {
     app_event_callback_node_t *callback_node =
-        app_event_node_find_callback(&app_context.dynamic_callback_header, event_id, callback);
+        app_event_node_find_callback(head, event_id, callback);
     if (NULL != callback_node) {
-        if ((event_id == SRV_EVENT_ALL && SRV_EVENT_ALL != app_context.invoking)
-                || event_id == app_context.invoking) {
+        // only defer the free while the list is being walked
+        if (SRV_EVENT_ALL != invoking
+                && (event_id == SRV_EVENT_ALL || event_id == invoking)) {
             callback_node->dirty = true;
         } else {
             app_event_node_remove(&callback_node->pointer);
@@ -89,13 +224,139 @@ void app_event_deregister_callback(srv_event_t event_id, app_event_callback_t ca
         }
     }
 }
-static srv_status_t app_event_invoke(srv_event_t event, void *parameters)
+#ifdef APP_EVENT_SHARD_ENABLE
+static void app_event_shard_apply(app_event_shard_t *shard, app_event_shard_request_t *request)
+{
+    app_event_callback_node_t *callback_node;
+    if (!request->subscribe) {
+        app_event_list_deregister(&shard->dynamic_callback_header, shard->invoking,
+                                  request->event_id, request->callback);
+        return;
+    }
+    callback_node = app_event_node_find_callback(&shard->dynamic_callback_header, request->event_id, request->callback);
+    if (NULL == callback_node) {
+        // the preallocated node becomes the subscriber node of this shard
+        app_event_node_insert(&shard->dynamic_callback_header, &request->node->pointer);
+        request->node = NULL;
+    } else {
+        callback_node->dirty = false;
+    }
+}
+/* Update the subscriber list of shards 0 to shard_num - 1 and return when all of them are updated.
+ * A list is only touched by its own dispatcher, other shards get a control event and the caller waits for it,
+ * so events queued before a deregister may still reach the callback, but none after this returns.
+ * Only shard 0 and plain tasks may wait, the other dispatchers never do, so no two dispatchers wait on each other. */
+static srv_status_t app_event_shard_subscribe(uint32_t shard_num, bool subscribe,
+        srv_event_t event_id, app_event_callback_t callback)
+{
+    app_event_shard_request_t request[APP_EVENT_SHARD_NUM];
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    srv_status_t result = SRV_STATUS_SUCCESS;
+    app_event_shard_t *shard;
+    app_event_t event;
+    uint32_t i;
+    for (i = 1; i < APP_EVENT_SHARD_NUM; i++) {
+        if (current == app_context.shard[i].task_handle) {
+            app_report("[Sink] shard:%d dispatcher can not change subscribers", i);
+            return SRV_STATUS_INVALID_STATUS;
+        }
+    }
+    // allocate everything first, so the lists are either all updated or all left untouched
+    memset(request, 0, sizeof(request));
+    for (i = 0; i < shard_num; i++) {
+        shard = &app_context.shard[i];
+        request[i].subscribe = subscribe;
+        request[i].event_id = event_id;
+        request[i].callback = callback;
+        if (NULL == shard->queue_handle) {
+            // not initialized or the queue could not be created, nothing would dispatch the callback
+            result = SRV_STATUS_INVALID_STATUS;
+            break;
+        }
+        if (subscribe) {
+            request[i].node = (app_event_callback_node_t *)pvPortMalloc(sizeof(app_event_callback_node_t));
+            if (NULL == request[i].node) {
+                result = SRV_STATUS_FAIL;
+                break;
+            }
+            memset(request[i].node, 0, sizeof(app_event_callback_node_t));
+            request[i].node->event_id = event_id;
+            request[i].node->callback = callback;
+        }
+        if (current != shard->task_handle) {
+            request[i].done = xSemaphoreCreateBinary();
+            if (NULL == request[i].done) {
+                result = SRV_STATUS_FAIL;
+                break;
+            }
+        }
+    }
+    for (i = 0; i < shard_num && SRV_STATUS_SUCCESS == result; i++) {
+        shard = &app_context.shard[i];
+        if (current == shard->task_handle) {
+            app_event_shard_apply(shard, &request[i]);
+            continue;
+        }
+        memset(&event, 0, sizeof(app_event_t));
+        event.parameters = &request[i];
+        event.control = true;
+        while (pdPASS != xQueueSend(shard->queue_handle, &event, portMAX_DELAY)) {
+        }
+        xSemaphoreTake(request[i].done, portMAX_DELAY);
+    }
+    for (i = 0; i < shard_num; i++) {
+        if (NULL != request[i].node) {
+            vPortFree((void *)request[i].node);
+        }
+        if (NULL != request[i].done) {
+            vSemaphoreDelete(request[i].done);
+        }
+    }
+    if (SRV_STATUS_SUCCESS != result) {
+        app_report("[Sink][Fatal Error] subscribe fail, event:0x%x", event_id);
+    }
+    return result;
+}
+#endif
+srv_status_t app_event_register_callback(srv_event_t event_id, app_event_callback_t callback)
+{
+#ifdef APP_EVENT_SHARD_ENABLE
+    // not shard safe, the callback only runs on shard 0
+    return app_event_shard_subscribe(1, true, event_id, callback);
+#else
+    return app_event_list_register(&app_context.dynamic_callback_header, event_id, callback);
+#endif
+}
+srv_status_t app_event_deregister_callback(srv_event_t event_id, app_event_callback_t callback)
+{
+#ifdef APP_EVENT_SHARD_ENABLE
+    return app_event_shard_subscribe(1, false, event_id, callback);
+#else
+    app_event_list_deregister(&app_context.dynamic_callback_header, app_context.invoking, event_id, callback);
+    return SRV_STATUS_SUCCESS;
+#endif
+}
+#ifdef APP_EVENT_SHARD_ENABLE
+srv_status_t app_event_register_shard_callback(srv_event_t event_id, app_event_callback_t callback)
+{
+    return app_event_shard_subscribe(APP_EVENT_SHARD_NUM, true, event_id, callback);
+}
+srv_status_t app_event_deregister_shard_callback(srv_event_t event_id, app_event_callback_t callback)
+{
+    return app_event_shard_subscribe(APP_EVENT_SHARD_NUM, false, event_id, callback);
+}
+#endif
+static srv_status_t app_event_invoke(app_event_node_t *head, srv_event_t *invoking,
+        srv_event_t event, void *parameters)
 {
     srv_status_t result = SRV_STATUS_SUCCESS;
-    app_event_node_t *dynamic_callback = &app_context.dynamic_callback_header;
-    app_context.invoking = event;
-    while ((dynamic_callback = dynamic_callback->next) != &app_context.dynamic_callback_header) {
-        if (SRV_EVENT_ALL == ((app_event_callback_node_t *)dynamic_callback)->event_id) {
+    app_event_node_t *dynamic_callback = head;
+    *invoking = event;
+    while ((dynamic_callback = dynamic_callback->next) != head) {
+        if (((app_event_callback_node_t *)dynamic_callback)->dirty) {
+            // deregistered during this event
+            continue;
+        } else if (SRV_EVENT_ALL == ((app_event_callback_node_t *)dynamic_callback)->event_id) {
             result = ((app_event_callback_node_t *)dynamic_callback)->callback(event, parameters);
             if (SRV_STATUS_EVENT_STOP == result) {
                 // TRACE
@@ -111,9 +372,9 @@ static srv_status_t app_event_invoke(srv_event_t event, void *parameters)
             // TRACE
         }
     }
-    app_context.invoking = SRV_EVENT_ALL;
-    dynamic_callback = app_context.dynamic_callback_header.next;
-    while (dynamic_callback != &app_context.dynamic_callback_header) {
+    *invoking = SRV_EVENT_ALL;
+    dynamic_callback = head->next;
+    while (dynamic_callback != head) {
         if (((app_event_callback_node_t *)dynamic_callback)->dirty) {
             app_event_node_t *dirty_node = dynamic_callback;
             dynamic_callback = dynamic_callback->next;
@@ -125,17 +386,74 @@ static srv_status_t app_event_invoke(srv_event_t event, void *parameters)
     }
     return result;
 }
+#ifndef APP_EVENT_SHARD_ENABLE
 void app_event_process(app_event_t *event)
 {
     srv_status_t result;
     if (NULL != event) {
         app_report("[Sink] app_event_process:0x%x" , event->event_id);
-        result = app_event_invoke(event->event_id, event->parameters);
+        result = app_event_invoke(&app_context.dynamic_callback_header, &app_context.invoking,
+                                  event->event_id, event->parameters);
         if (event->post_callback) {
             event->post_callback(event->event_id, result, event->parameters);
         }
     }
 }
+#else
+static void app_event_shard_process(app_event_shard_t *shard, app_event_t *event)
+{
+    srv_status_t result;
+    app_report("[Sink] app_event_shard_process:0x%x" , event->event_id);
+    result = app_event_invoke(&shard->dynamic_callback_header, &shard->invoking,
+                              event->event_id, event->parameters);
+    if (event->post_callback) {
+        event->post_callback(event->event_id, result, event->parameters);
+    }
+}
+void app_event_shard_loop(uint32_t shard_index)
+{
+    app_event_shard_t *shard = &app_context.shard[shard_index];
+    app_event_shard_request_t *request;
+    app_event_t event;
+    uint32_t pending;
+    if (NULL == shard->queue_handle) {
+        app_report("[Sink][Fatal Error] shard:%d has no queue", shard_index);
+        return;
+    }
+    while (1) {
+        if (pdPASS != xQueueReceive(shard->queue_handle, &event, portMAX_DELAY)) {
+            continue;
+        }
+        if (event.control) {
+            request = (app_event_shard_request_t *)event.parameters;
+            app_event_shard_apply(shard, request);
+            xSemaphoreGive(request->done);
+            continue;
+        }
+        // processed and max_pending are only written by the owner dispatcher,
+        // max_pending counts the events waiting behind the one being dispatched
+        pending = (uint32_t)uxQueueMessagesWaiting(shard->queue_handle);
+        if (pending > shard->stats.max_pending) {
+            __atomic_store_n(&shard->stats.max_pending, pending, __ATOMIC_RELAXED);
+        }
+        app_event_shard_process(shard, &event);
+        __atomic_store_n(&shard->stats.processed, shard->stats.processed + 1, __ATOMIC_RELAXED);
+    }
+}
+srv_status_t app_event_shard_get_stats(uint32_t shard_index, app_event_shard_stats_t *stats)
+{
+    app_event_shard_t *shard;
+    if (shard_index >= APP_EVENT_SHARD_NUM || NULL == stats) {
+        return SRV_STATUS_INVALID_PARAM;
+    }
+    shard = &app_context.shard[shard_index];
+    stats->posted = __atomic_load_n(&shard->stats.posted, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&shard->stats.dropped, __ATOMIC_RELAXED);
+    stats->processed = __atomic_load_n(&shard->stats.processed, __ATOMIC_RELAXED);
+    stats->max_pending = __atomic_load_n(&shard->stats.max_pending, __ATOMIC_RELAXED);
+    return SRV_STATUS_SUCCESS;
+}
+#endif
 void app_event_post_callback(srv_event_t event_id, srv_status_t result, void *parameters)
 {
     app_report("[Sink] free event:0x%x params:0x%x", event_id, parameters);
@@ -0,0 +1,381 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_main.h"
+#include "app_event.h"
+#include "app_key_gesture.h"
+#include "srv.h"
+
+#define APP_KEY_GESTURE_STATE_IDLE          (0x00)
+#define APP_KEY_GESTURE_STATE_PRESSED       (0x01)
+#define APP_KEY_GESTURE_STATE_CLICK_WAIT    (0x02)
+#define APP_KEY_GESTURE_LEVEL_NUM           (3)
+typedef uint8_t app_key_gesture_state_t;
+
+typedef struct {
+    srv_key_value_t key_value;
+    bool pressed;
+    uint32_t timestamp;
+} app_key_gesture_edge_t;
+
+typedef struct {
+    app_key_gesture_config_t config;
+    app_key_gesture_state_t state;
+    uint8_t clicks;
+    uint8_t level;
+    uint32_t edge_time;
+    app_key_gesture_stats_t stats;
+} app_key_gesture_key_t;
+
+typedef struct {
+    app_key_gesture_key_t key[APP_KEY_GESTURE_KEY_NUM];
+    app_key_gesture_edge_t edge[APP_KEY_GESTURE_EDGE_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t tail;
+    bool wakeup_pending;
+    TimerHandle_t timer_handle;
+} app_key_gesture_context_t;
+
+static app_key_gesture_context_t app_key_gesture_context;
+
+static const srv_key_action_t app_key_gesture_down_action[APP_KEY_GESTURE_LEVEL_NUM] = {
+    SRV_KEY_ACT_LONG_PRESS_DOWN,
+    SRV_KEY_ACT_LONG_LONG_PRESS_DOWN,
+    SRV_KEY_ACT_VERY_LONG_PRESS_DOWN
+};
+static const srv_key_action_t app_key_gesture_up_action[APP_KEY_GESTURE_LEVEL_NUM] = {
+    SRV_KEY_ACT_LONG_PRESS_UP,
+    SRV_KEY_ACT_LONG_LONG_PRESS_UP,
+    SRV_KEY_ACT_VERY_LONG_PRESS_UP
+};
+static const srv_key_action_t app_key_gesture_click_action[APP_KEY_GESTURE_MAX_CLICKS] = {
+    SRV_KEY_ACT_PRESS_UP,
+    SRV_KEY_ACT_DOUBLE_CLICK,
+    SRV_KEY_ACT_TRIPLE_CLICK
+};
+
+static uint32_t app_key_gesture_now(void)
+{
+    return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+static bool app_key_gesture_reached(uint32_t now, uint32_t deadline)
+{
+    // wrap safe compare of ms timestamps
+    return ((int32_t)(now - deadline)) >= 0;
+}
+static uint32_t app_key_gesture_threshold(app_key_gesture_key_t *key, uint8_t level)
+{
+    const uint32_t threshold[APP_KEY_GESTURE_LEVEL_NUM] = {
+        key->config.long_press_time,
+        key->config.long_long_press_time,
+        key->config.very_long_press_time
+    };
+    return threshold[level];
+}
+static void app_key_gesture_emit(srv_key_value_t key_value, srv_key_action_t key_action, uint32_t reference, uint32_t now)
+{
+    app_key_gesture_key_t *key = &app_key_gesture_context.key[key_value];
+    app_ext_cmd_t *ext_cmd_p;
+    uint32_t latency = ((int32_t)(now - reference) > 0) ? (now - reference) : 0;
+    key->stats.emitted++;
+    key->stats.last_latency = latency;
+    if (latency > key->stats.max_latency) {
+        key->stats.max_latency = latency;
+    }
+    app_report("[Sink] key gesture, key:%d action:%d latency:%d", key_value, key_action, latency);
+    ext_cmd_p = (app_ext_cmd_t *)pvPortMalloc(sizeof(*ext_cmd_p));
+    if (NULL == ext_cmd_p) {
+        app_report("[Sink] key gesture malloc fail");
+        return;
+    }
+    ext_cmd_p->key_value = key_value;
+    ext_cmd_p->key_action = key_action;
+    app_event_post(EVENT_APP_EXT_COMMAND, (void *)ext_cmd_p, app_event_post_callback);
+}
+static void app_key_gesture_emit_clicks(srv_key_value_t key_value, uint32_t reference, uint32_t now)
+{
+    app_key_gesture_key_t *key = &app_key_gesture_context.key[key_value];
+    if (key->clicks > 0) {
+        app_key_gesture_emit(key_value, app_key_gesture_click_action[key->clicks - 1], reference, now);
+        key->clicks = 0;
+    }
+}
+/* Report every deadline which has passed at time, now is only used for the latency. */
+static void app_key_gesture_check(srv_key_value_t key_value, uint32_t time, uint32_t now)
+{
+    app_key_gesture_key_t *key = &app_key_gesture_context.key[key_value];
+    uint32_t deadline;
+    if (APP_KEY_GESTURE_STATE_PRESSED == key->state) {
+        while (key->level < APP_KEY_GESTURE_LEVEL_NUM && 0 != app_key_gesture_threshold(key, key->level)) {
+            deadline = key->edge_time + app_key_gesture_threshold(key, key->level);
+            if (!app_key_gesture_reached(time, deadline)) {
+                break;
+            }
+            if (0 == key->level) {
+                // a hold after clicks ends the click sequence first
+                app_key_gesture_emit_clicks(key_value, deadline, now);
+            }
+            app_key_gesture_emit(key_value, app_key_gesture_down_action[key->level], deadline, now);
+            key->level++;
+        }
+    } else if (APP_KEY_GESTURE_STATE_CLICK_WAIT == key->state) {
+        deadline = key->edge_time + key->config.multi_click_time;
+        if (app_key_gesture_reached(time, deadline)) {
+            app_key_gesture_emit_clicks(key_value, deadline, now);
+            key->state = APP_KEY_GESTURE_STATE_IDLE;
+        }
+    }
+}
+static void app_key_gesture_handle_edge(app_key_gesture_edge_t *edge, uint32_t now)
+{
+    app_key_gesture_key_t *key = &app_key_gesture_context.key[edge->key_value];
+    app_key_gesture_check(edge->key_value, edge->timestamp, now);
+    if (edge->pressed) {
+        if (APP_KEY_GESTURE_STATE_IDLE == key->state) {
+            key->clicks = 0;
+            app_key_gesture_emit(edge->key_value, SRV_KEY_ACT_PRESS_DOWN, edge->timestamp, now);
+        } else if (APP_KEY_GESTURE_STATE_PRESSED == key->state) {
+            // release edge lost, keep the current press
+            return;
+        }
+        key->state = APP_KEY_GESTURE_STATE_PRESSED;
+        key->level = 0;
+        key->edge_time = edge->timestamp;
+        return;
+    }
+    if (APP_KEY_GESTURE_STATE_PRESSED != key->state) {
+        return;
+    }
+    if (key->level > 0) {
+        app_key_gesture_emit(edge->key_value, app_key_gesture_up_action[key->level - 1], edge->timestamp, now);
+        key->state = APP_KEY_GESTURE_STATE_IDLE;
+        return;
+    }
+    key->clicks++;
+    if (key->clicks >= key->config.max_clicks) {
+        // no longer gesture is possible, report at once
+        app_key_gesture_emit_clicks(edge->key_value, edge->timestamp, now);
+        key->state = APP_KEY_GESTURE_STATE_IDLE;
+    } else {
+        key->state = APP_KEY_GESTURE_STATE_CLICK_WAIT;
+        key->edge_time = edge->timestamp;
+    }
+}
+static bool app_key_gesture_next_deadline(uint32_t *deadline)
+{
+    app_key_gesture_key_t *key;
+    uint32_t candidate;
+    bool found = false;
+    uint32_t i;
+    for (i = 0; i < APP_KEY_GESTURE_KEY_NUM; i++) {
+        key = &app_key_gesture_context.key[i];
+        if (APP_KEY_GESTURE_STATE_PRESSED == key->state
+                && key->level < APP_KEY_GESTURE_LEVEL_NUM
+                && 0 != app_key_gesture_threshold(key, key->level)) {
+            candidate = key->edge_time + app_key_gesture_threshold(key, key->level);
+        } else if (APP_KEY_GESTURE_STATE_CLICK_WAIT == key->state) {
+            candidate = key->edge_time + key->config.multi_click_time;
+        } else {
+            continue;
+        }
+        if (!found || ((int32_t)(candidate - *deadline)) < 0) {
+            *deadline = candidate;
+            found = true;
+        }
+    }
+    return found;
+}
+/* Return false when no wakeup is queued, the caller has to arrange a retry. */
+static bool app_key_gesture_wakeup(void)
+{
+    bool post = false;
+    taskENTER_CRITICAL();
+    if (!app_key_gesture_context.wakeup_pending) {
+        app_key_gesture_context.wakeup_pending = true;
+        post = true;
+    }
+    taskEXIT_CRITICAL();
+    if (post && SRV_STATUS_SUCCESS != app_event_post(EVENT_APP_KEY_GESTURE_WAKEUP, NULL, NULL)) {
+        taskENTER_CRITICAL();
+        app_key_gesture_context.wakeup_pending = false;
+        taskEXIT_CRITICAL();
+        return false;
+    }
+    return true;
+}
+/* Fire the one-shot timer on the next tick, its callback posts the wakeup again. */
+static bool app_key_gesture_retry(void)
+{
+    if (NULL == app_key_gesture_context.timer_handle) {
+        return false;
+    }
+    return pdPASS == xTimerChangePeriod(app_key_gesture_context.timer_handle, 1, 0);
+}
+static void app_key_gesture_timer_callback(TimerHandle_t timer_handle)
+{
+    // the deadline has passed, keep the timer running until the app queue takes the wakeup
+    if (!app_key_gesture_wakeup() && pdPASS != xTimerChangePeriod(timer_handle, 1, 0)) {
+        app_report("[Sink][Fatal Error] key gesture wakeup lost");
+    }
+}
+static bool app_key_gesture_push(srv_key_value_t key_value, bool pressed, uint32_t timestamp)
+{
+    uint8_t next = (app_key_gesture_context.head + 1) % APP_KEY_GESTURE_EDGE_QUEUE_SIZE;
+    if (next == app_key_gesture_context.tail) {
+        app_key_gesture_context.key[key_value].stats.dropped++;
+        return false;
+    }
+    app_key_gesture_context.edge[app_key_gesture_context.head].key_value = key_value;
+    app_key_gesture_context.edge[app_key_gesture_context.head].pressed = pressed;
+    app_key_gesture_context.edge[app_key_gesture_context.head].timestamp = timestamp;
+    app_key_gesture_context.head = next;
+    return true;
+}
+static bool app_key_gesture_pop(app_key_gesture_edge_t *edge)
+{
+    bool result = false;
+    taskENTER_CRITICAL();
+    if (app_key_gesture_context.tail != app_key_gesture_context.head) {
+        *edge = app_key_gesture_context.edge[app_key_gesture_context.tail];
+        app_key_gesture_context.tail = (app_key_gesture_context.tail + 1) % APP_KEY_GESTURE_EDGE_QUEUE_SIZE;
+        result = true;
+    }
+    taskEXIT_CRITICAL();
+    return result;
+}
+void app_key_gesture_init(void)
+{
+    uint32_t i;
+    memset(&app_key_gesture_context, 0, sizeof(app_key_gesture_context_t));
+    for (i = 0; i < APP_KEY_GESTURE_KEY_NUM; i++) {
+        app_key_gesture_context.key[i].config.long_press_time = APP_KEY_GESTURE_LONG_PRESS_TIME;
+        app_key_gesture_context.key[i].config.long_long_press_time = APP_KEY_GESTURE_LONG_LONG_PRESS_TIME;
+        app_key_gesture_context.key[i].config.very_long_press_time = APP_KEY_GESTURE_VERY_LONG_PRESS_TIME;
+        app_key_gesture_context.key[i].config.multi_click_time = APP_KEY_GESTURE_MULTI_CLICK_TIME;
+        app_key_gesture_context.key[i].config.max_clicks = APP_KEY_GESTURE_MAX_CLICKS;
+    }
+    app_key_gesture_context.timer_handle = xTimerCreate("app_key",
+                                           1,
+                                           pdFALSE,
+                                           NULL,
+                                           app_key_gesture_timer_callback);
+    if (NULL == app_key_gesture_context.timer_handle) {
+        app_report("[Sink][Fatal Error] key gesture timer create fail");
+    }
+}
+srv_status_t app_key_gesture_set_config(srv_key_value_t key_value, const app_key_gesture_config_t *config)
+{
+    if (key_value == SRV_KEY_NONE || key_value >= APP_KEY_GESTURE_KEY_NUM || NULL == config
+            || 0 == config->max_clicks || config->max_clicks > APP_KEY_GESTURE_MAX_CLICKS) {
+        return SRV_STATUS_INVALID_PARAM;
+    }
+    // enabled levels must be strictly increasing, or one hold would cross several at once
+    if ((0 != config->long_long_press_time && config->long_long_press_time <= config->long_press_time)
+            || (0 != config->very_long_press_time && config->very_long_press_time <= config->long_long_press_time)) {
+        return SRV_STATUS_INVALID_PARAM;
+    }
+    taskENTER_CRITICAL();
+    memcpy(&app_key_gesture_context.key[key_value].config, config, sizeof(app_key_gesture_config_t));
+    taskEXIT_CRITICAL();
+    return SRV_STATUS_SUCCESS;
+}
+srv_status_t app_key_gesture_edge(srv_key_value_t key_value, bool pressed, uint32_t timestamp)
+{
+    bool result;
+    if (key_value == SRV_KEY_NONE || key_value >= APP_KEY_GESTURE_KEY_NUM) {
+        return SRV_STATUS_INVALID_PARAM;
+    }
+    taskENTER_CRITICAL();
+    result = app_key_gesture_push(key_value, pressed, timestamp);
+    taskEXIT_CRITICAL();
+    if (!result) {
+        app_report("[Sink] key gesture edge lost, key:%d", key_value);
+        return SRV_STATUS_FAIL;
+    }
+    if (!app_key_gesture_wakeup() && !app_key_gesture_retry()) {
+        app_report("[Sink] key gesture edge not scheduled, key:%d", key_value);
+        return SRV_STATUS_FAIL;
+    }
+    return SRV_STATUS_SUCCESS;
+}
+srv_status_t app_key_gesture_edge_from_isr(srv_key_value_t key_value, bool pressed, uint32_t timestamp)
+{
+    UBaseType_t saved_mask;
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    bool result;
+    bool post = false;
+    if (key_value == SRV_KEY_NONE || key_value >= APP_KEY_GESTURE_KEY_NUM) {
+        return SRV_STATUS_INVALID_PARAM;
+    }
+    saved_mask = taskENTER_CRITICAL_FROM_ISR();
+    result = app_key_gesture_push(key_value, pressed, timestamp);
+    if (result && !app_key_gesture_context.wakeup_pending) {
+        app_key_gesture_context.wakeup_pending = true;
+        post = true;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(saved_mask);
+    if (!result) {
+        return SRV_STATUS_FAIL;
+    }
+    if (post && SRV_STATUS_SUCCESS != app_event_post_from_isr(EVENT_APP_KEY_GESTURE_WAKEUP, NULL)) {
+        saved_mask = taskENTER_CRITICAL_FROM_ISR();
+        app_key_gesture_context.wakeup_pending = false;
+        taskEXIT_CRITICAL_FROM_ISR(saved_mask);
+        // app queue is full, let the timer post the wakeup on the next tick
+        if (NULL == app_key_gesture_context.timer_handle
+                || pdPASS != xTimerChangePeriodFromISR(app_key_gesture_context.timer_handle, 1, &higher_priority_task_woken)) {
+            return SRV_STATUS_FAIL;
+        }
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+    }
+    return SRV_STATUS_SUCCESS;
+}
+srv_status_t app_key_gesture_get_stats(srv_key_value_t key_value, app_key_gesture_stats_t *stats)
+{
+    if (key_value == SRV_KEY_NONE || key_value >= APP_KEY_GESTURE_KEY_NUM || NULL == stats) {
+        return SRV_STATUS_INVALID_PARAM;
+    }
+    taskENTER_CRITICAL();
+    memcpy(stats, &app_key_gesture_context.key[key_value].stats, sizeof(app_key_gesture_stats_t));
+    taskEXIT_CRITICAL();
+    return SRV_STATUS_SUCCESS;
+}
+srv_status_t app_key_gesture_event_handler(srv_event_t event_id, void *parameters)
+{
+    app_key_gesture_edge_t edge;
+    uint32_t now;
+    uint32_t deadline = 0;
+    uint32_t i;
+    BaseType_t result;
+    if (EVENT_APP_KEY_GESTURE_WAKEUP != event_id) {
+        return SRV_STATUS_SUCCESS;
+    }
+    // the wakeup event is dequeued, edges pushed from now on need a new one
+    taskENTER_CRITICAL();
+    app_key_gesture_context.wakeup_pending = false;
+    taskEXIT_CRITICAL();
+    now = app_key_gesture_now();
+    while (app_key_gesture_pop(&edge)) {
+        app_key_gesture_handle_edge(&edge, now);
+    }
+    for (i = 0; i < APP_KEY_GESTURE_KEY_NUM; i++) {
+        app_key_gesture_check((srv_key_value_t)i, now, now);
+    }
+    if (NULL == app_key_gesture_context.timer_handle) {
+        return SRV_STATUS_SUCCESS;
+    }
+    if (app_key_gesture_next_deadline(&deadline)) {
+        TickType_t ticks = pdMS_TO_TICKS(((int32_t)(deadline - now) > 0) ? (deadline - now) : 0);
+        result = xTimerChangePeriod(app_key_gesture_context.timer_handle, (ticks > 0) ? ticks : 1, 0);
+    } else {
+        result = xTimerStop(app_key_gesture_context.timer_handle, 0);
+    }
+    if (pdPASS != result) {
+        // timer command queue is full, come back through the app queue and arm it again
+        app_report("[Sink] key gesture timer command fail, retry");
+        if (!app_key_gesture_wakeup()) {
+            app_report("[Sink][Fatal Error] key gesture timer retry lost");
+        }
+    }
+    return SRV_STATUS_SUCCESS;
+}
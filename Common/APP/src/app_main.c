@@ -2,6 +2,9 @@
 #include "task.h"
 #include "app_main.h"
 #include "app_event.h"
+#ifdef APP_KEY_GESTURE_ENABLE
+#include "app_key_gesture.h"
+#endif
 #include "srv.h"
 app_context_t app_context;
 static void bt_sink_app_init_device_role(void);
@@ -32,8 +35,14 @@ void app_task_main(void *arg)
 #ifdef APP_NO_ACTION_AUTO_POWER_OFF
     //TODO
 #endif
+#ifndef APP_EVENT_SHARD_ENABLE
     app_context.queue_handle = xQueueCreate(APP_QUEUE_SIZE, sizeof(app_event_t));
+#endif
     //app_event_register_callback(EVENT_APP_KEY_INPUT, app_keypad_event_handler);
+#ifdef APP_KEY_GESTURE_ENABLE
+    app_key_gesture_init();
+    app_event_register_callback(EVENT_APP_KEY_GESTURE_WAKEUP, app_key_gesture_event_handler);
+#endif
     app_event_register_callback(SRV_EVENT_ALL, app_event_handler);
     //app_atci_init();
     //app_keypad_init();
@@ -42,11 +51,18 @@ void app_task_main(void *arg)
     app_context.feature_config.features = NULL;
     srv_init(&(app_context.feature_config));
     
+#ifdef APP_EVENT_SHARD_ENABLE
+    // app task serves shard 0, the other shards are created by app_event_init
+    app_event_shard_loop(0);
+    // only reached when the shard 0 queue could not be created
+    vTaskDelete(NULL);
+#else
     while (1) {
         if (pdPASS == xQueueReceive(app_context.queue_handle, &event, portMAX_DELAY)) {
             app_event_process(&event);
         }
     }
+#endif
 }
 void app_task_create(void)
 {
@@ -0,0 +1,88 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "app_main.h"
+#include "app_event.h"
+
+#define BENCH_PRODUCER_NUM  (4)
+#define BENCH_EVENT_NUM     (50000)
+#define BENCH_WORK          (2000)
+#define BENCH_EVENT         (EVENT_APP_BASE + 20)
+
+app_context_t app_context;
+
+static SemaphoreHandle_t bench_ready;
+static volatile uint32_t bench_sink[APP_EVENT_SHARD_NUM * 16];
+
+/* Synthetic handler cost, each shard writes its own cache line. */
+static srv_status_t bench_callback(srv_event_t event_id, void *parameters)
+{
+    uint32_t value = (uint32_t)(uintptr_t)parameters;
+    uint32_t i;
+    for (i = 0; i < BENCH_WORK; i++) {
+        value ^= value << 13;
+        value ^= value >> 17;
+        value ^= value << 5;
+    }
+    bench_sink[((uint32_t)(uintptr_t)parameters % APP_EVENT_SHARD_NUM) * 16] = value;
+    return SRV_STATUS_SUCCESS;
+}
+static void bench_app_task(void *arg)
+{
+    memset(&app_context, 0, sizeof(app_context_t));
+    app_event_init();
+    xSemaphoreGive(bench_ready);
+    app_event_shard_loop(0);
+}
+static void *bench_producer(void *arg)
+{
+    uint32_t producer = (uint32_t)(uintptr_t)arg;
+    uint32_t seq;
+    for (seq = 0; seq < BENCH_EVENT_NUM; seq++) {
+        while (SRV_STATUS_SUCCESS != app_event_post_with_key(BENCH_EVENT, producer, (void *)(uintptr_t)(producer + 1), NULL)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+static uint32_t bench_processed(void)
+{
+    app_event_shard_stats_t stats;
+    uint32_t processed = 0;
+    uint32_t i;
+    for (i = 0; i < APP_EVENT_SHARD_NUM; i++) {
+        app_event_shard_get_stats(i, &stats);
+        processed += stats.processed;
+    }
+    return processed;
+}
+int main(void)
+{
+    pthread_t producer[BENCH_PRODUCER_NUM];
+    struct timespec start;
+    struct timespec end;
+    double seconds;
+    uint32_t i;
+    bench_ready = xSemaphoreCreateBinary();
+    xTaskCreate(bench_app_task, APP_TASK_NAME, APP_TASK_STACKSIZE, NULL, APP_TASK_PRIO, NULL);
+    xSemaphoreTake(bench_ready, portMAX_DELAY);
+    app_event_register_shard_callback(BENCH_EVENT, bench_callback);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < BENCH_PRODUCER_NUM; i++) {
+        pthread_create(&producer[i], NULL, bench_producer, (void *)(uintptr_t)i);
+    }
+    for (i = 0; i < BENCH_PRODUCER_NUM; i++) {
+        pthread_join(producer[i], NULL);
+    }
+    while (bench_processed() < BENCH_PRODUCER_NUM * BENCH_EVENT_NUM) {
+        usleep(100);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("shards:%d producers:%d events:%d time:%.3fs rate:%.0f events/s\n",
+           APP_EVENT_SHARD_NUM, BENCH_PRODUCER_NUM, BENCH_PRODUCER_NUM * BENCH_EVENT_NUM,
+           seconds, (double)(BENCH_PRODUCER_NUM * BENCH_EVENT_NUM) / seconds);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+/* Host shim of the FreeRTOS API used by Common/APP, built on pthreads. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+typedef struct shim_queue *QueueHandle_t;
+typedef struct shim_queue *SemaphoreHandle_t;
+typedef struct shim_task *TaskHandle_t;
+typedef struct shim_timer *TimerHandle_t;
+typedef void (*TaskFunction_t)(void *);
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+#define pdFALSE                 (0)
+#define pdTRUE                  (1)
+#define pdFAIL                  (0)
+#define pdPASS                  (1)
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS      (1)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(x)   ((void)(x))
+#define configUSE_CORE_AFFINITY (0)
+#define configNUMBER_OF_CORES   (1)
+
+#define taskENTER_CRITICAL()              shim_critical_enter()
+#define taskEXIT_CRITICAL()               shim_critical_exit()
+#define taskENTER_CRITICAL_FROM_ISR()     (shim_critical_enter(), (UBaseType_t)0)
+#define taskEXIT_CRITICAL_FROM_ISR(mask)  ((void)(mask), shim_critical_exit())
+
+/* Test controls: the tick is only moved by the test, a timer command fails while shim_timer_fail > 0. */
+extern volatile TickType_t shim_tick;
+extern volatile int shim_timer_fail;
+
+void shim_critical_enter(void);
+void shim_critical_exit(void);
+void shim_timer_reset(void);
+TimerHandle_t shim_timer_due(TickType_t now);
+void shim_timer_fire(TimerHandle_t timer);
+
+void *pvPortMalloc(size_t size);
+void vPortFree(void *pointer);
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *created);
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload,
+                           void *timer_id, TimerCallbackFunction_t callback);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+BaseType_t xTimerChangePeriodFromISR(TimerHandle_t timer, TickType_t period, BaseType_t *woken);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+#endif
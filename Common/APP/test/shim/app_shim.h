@@ -0,0 +1,18 @@
+#ifndef APP_SHIM_H
+#define APP_SHIM_H
+/* Forced include for the host build: log hook and legacy names the product headers provide on target. */
+#ifdef APP_TEST_LOG
+#include <stdio.h>
+#define app_report(...) (printf(__VA_ARGS__), printf("\n"))
+#else
+#define app_report(...) ((void)0)
+#endif
+#define APP_TASK_NAME                           "app"
+#define APP_TASK_STACKSIZE                      (4096)
+#define APP_TASK_PRIO                           (1)
+#define bt_sink_app_event_t                     app_event_t
+#define BT_SINK_EVENT_APP_EXT_COMMAND           EVENT_APP_EXT_COMMAND
+#define BT_SINK_EVENT_APP_SYS_LOG_ON            EVENT_APP_SYS_LOG_ON
+#define BT_SINK_EVENT_APP_SYS_LOG_OFF           EVENT_APP_SYS_LOG_OFF
+#define BT_SINK_EVENT_APP_BATTERY_NOTIFICATION  EVENT_APP_BATTERY_NOTIFICATION
+#endif
@@ -0,0 +1 @@
+#include "app_main.h"
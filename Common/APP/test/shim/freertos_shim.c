@@ -0,0 +1,272 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+
+#define SHIM_TIMER_NUM (8)
+
+struct shim_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *buffer;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct shim_task {
+    pthread_t thread;
+    TaskFunction_t function;
+    void *parameters;
+};
+
+struct shim_timer {
+    TimerCallbackFunction_t callback;
+    TickType_t expiry;
+    bool active;
+};
+
+volatile TickType_t shim_tick;
+volatile int shim_timer_fail;
+
+static pthread_mutex_t shim_critical_mutex;
+static pthread_once_t shim_critical_once = PTHREAD_ONCE_INIT;
+static __thread struct shim_task *shim_current_task;
+static struct shim_timer *shim_timer_list[SHIM_TIMER_NUM];
+
+static void shim_critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&shim_critical_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+void shim_critical_enter(void)
+{
+    pthread_once(&shim_critical_once, shim_critical_init);
+    pthread_mutex_lock(&shim_critical_mutex);
+}
+void shim_critical_exit(void)
+{
+    pthread_mutex_unlock(&shim_critical_mutex);
+}
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+void vPortFree(void *pointer)
+{
+    free(pointer);
+}
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct shim_queue *queue = calloc(1, sizeof(*queue));
+    if (NULL == queue) {
+        return NULL;
+    }
+    queue->buffer = calloc(length, item_size);
+    if (NULL == queue->buffer) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return queue;
+}
+/* Any non zero wait blocks until it succeeds, the tests never rely on a finite timeout. */
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->length) {
+        if (0 == wait) {
+            pthread_mutex_unlock(&queue->mutex);
+            return pdFAIL;
+        }
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    }
+    memcpy(queue->buffer + ((queue->head + queue->count) % queue->length) * queue->item_size,
+           item, queue->item_size);
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+    if (NULL != woken) {
+        *woken = pdFALSE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (0 == queue->count) {
+        if (0 == wait) {
+            pthread_mutex_unlock(&queue->mutex);
+            return pdFAIL;
+        }
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    }
+    memcpy(item, queue->buffer + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+    pthread_mutex_lock(&queue->mutex);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 1);
+}
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    uint8_t token = 0;
+    return xQueueSend(semaphore, &token, 0);
+}
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    uint8_t token;
+    return xQueueReceive(semaphore, &token, wait);
+}
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    pthread_mutex_destroy(&semaphore->mutex);
+    pthread_cond_destroy(&semaphore->not_empty);
+    pthread_cond_destroy(&semaphore->not_full);
+    free(semaphore->buffer);
+    free(semaphore);
+}
+static void *shim_task_entry(void *arg)
+{
+    shim_current_task = (struct shim_task *)arg;
+    shim_current_task->function(shim_current_task->parameters);
+    return NULL;
+}
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *created)
+{
+    struct shim_task *task = calloc(1, sizeof(*task));
+    if (NULL == task) {
+        return pdFAIL;
+    }
+    task->function = function;
+    task->parameters = parameters;
+    // the handle is visible to the creator before the task runs, as on target
+    if (NULL != created) {
+        *created = task;
+    }
+    if (0 != pthread_create(&task->thread, NULL, shim_task_entry, task)) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+void vTaskDelete(TaskHandle_t task)
+{
+    if (NULL == task || task == shim_current_task) {
+        pthread_exit(NULL);
+    }
+}
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    // threads not created by xTaskCreate, such as main, get a handle on first use
+    if (NULL == shim_current_task) {
+        shim_current_task = calloc(1, sizeof(*shim_current_task));
+        shim_current_task->thread = pthread_self();
+    }
+    return shim_current_task;
+}
+TickType_t xTaskGetTickCount(void)
+{
+    return shim_tick;
+}
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload,
+                           void *timer_id, TimerCallbackFunction_t callback)
+{
+    uint32_t i;
+    for (i = 0; i < SHIM_TIMER_NUM; i++) {
+        if (NULL == shim_timer_list[i]) {
+            shim_timer_list[i] = calloc(1, sizeof(struct shim_timer));
+            if (NULL != shim_timer_list[i]) {
+                shim_timer_list[i]->callback = callback;
+            }
+            return shim_timer_list[i];
+        }
+    }
+    return NULL;
+}
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait)
+{
+    if (shim_timer_fail > 0) {
+        shim_timer_fail--;
+        return pdFAIL;
+    }
+    timer->expiry = shim_tick + period;
+    timer->active = true;
+    return pdPASS;
+}
+BaseType_t xTimerChangePeriodFromISR(TimerHandle_t timer, TickType_t period, BaseType_t *woken)
+{
+    if (NULL != woken) {
+        *woken = pdFALSE;
+    }
+    return xTimerChangePeriod(timer, period, 0);
+}
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait)
+{
+    if (shim_timer_fail > 0) {
+        shim_timer_fail--;
+        return pdFAIL;
+    }
+    timer->active = false;
+    return pdPASS;
+}
+void shim_timer_reset(void)
+{
+    uint32_t i;
+    for (i = 0; i < SHIM_TIMER_NUM; i++) {
+        free(shim_timer_list[i]);
+        shim_timer_list[i] = NULL;
+    }
+}
+/* Earliest active timer expired at now, NULL when none. */
+TimerHandle_t shim_timer_due(TickType_t now)
+{
+    TimerHandle_t due = NULL;
+    uint32_t i;
+    for (i = 0; i < SHIM_TIMER_NUM; i++) {
+        if (NULL == shim_timer_list[i] || !shim_timer_list[i]->active
+                || ((int32_t)(now - shim_timer_list[i]->expiry)) < 0) {
+            continue;
+        }
+        if (NULL == due || ((int32_t)(shim_timer_list[i]->expiry - due->expiry)) < 0) {
+            due = shim_timer_list[i];
+        }
+    }
+    return due;
+}
+/* Run the timer callback like the timer task would, the tick moves up to the expiry if it is behind,
+ * a test may set it past the expiry first to fire the timer late. */
+void shim_timer_fire(TimerHandle_t timer)
+{
+    if (((int32_t)(shim_tick - timer->expiry)) < 0) {
+        shim_tick = timer->expiry;
+    }
+    timer->active = false;
+    timer->callback(timer);
+}
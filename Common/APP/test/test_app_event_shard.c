@@ -0,0 +1,213 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "app_main.h"
+#include "app_event.h"
+
+#define TEST_PRODUCER_NUM   (4)
+#define TEST_EVENT_NUM      (20000)
+#define TEST_EVENT          (EVENT_APP_BASE + 20)
+#define TEST_PLAIN_EVENT    (EVENT_APP_BASE + 21)
+#define TEST_REJECT_EVENT   (EVENT_APP_BASE + 22)
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+app_context_t app_context;
+
+static int test_failures;
+static SemaphoreHandle_t test_ready;
+static uint32_t test_dropped;
+static uint32_t test_next_seq[TEST_PRODUCER_NUM];
+static uint32_t test_order_errors;
+static uint32_t test_shard_errors;
+static uint32_t test_delivered[APP_EVENT_SHARD_NUM];
+static uint32_t test_legacy_calls;
+static uint32_t test_legacy_errors;
+static int test_plain_shard = -1;
+static srv_status_t test_reject_result = SRV_STATUS_SUCCESS;
+
+static int test_current_shard(void)
+{
+    int i;
+    for (i = 0; i < APP_EVENT_SHARD_NUM; i++) {
+        if (app_context.shard[i].task_handle == xTaskGetCurrentTaskHandle()) {
+            return i;
+        }
+    }
+    return -1;
+}
+static srv_status_t test_shard_callback(srv_event_t event_id, void *parameters)
+{
+    uint32_t value = (uint32_t)(uintptr_t)parameters;
+    uint32_t producer = value >> 24;
+    uint32_t seq = value & 0xffffff;
+    int shard = test_current_shard();
+    if (TEST_REJECT_EVENT == event_id) {
+        test_reject_result = app_event_register_callback(TEST_REJECT_EVENT, test_shard_callback);
+        return SRV_STATUS_SUCCESS;
+    }
+    if (TEST_EVENT != event_id) {
+        return SRV_STATUS_SUCCESS;
+    }
+    if (shard < 0 || (uint32_t)shard != producer % APP_EVENT_SHARD_NUM) {
+        __atomic_fetch_add(&test_shard_errors, 1, __ATOMIC_RELAXED);
+        return SRV_STATUS_SUCCESS;
+    }
+    // a producer only lands on one shard, so its sequence is only touched by that dispatcher
+    if (seq != test_next_seq[producer]) {
+        __atomic_fetch_add(&test_order_errors, 1, __ATOMIC_RELAXED);
+    }
+    test_next_seq[producer] = seq + 1;
+    __atomic_fetch_add(&test_delivered[shard], 1, __ATOMIC_RELAXED);
+    return SRV_STATUS_SUCCESS;
+}
+static srv_status_t test_legacy_callback(srv_event_t event_id, void *parameters)
+{
+    if (0 != test_current_shard()) {
+        test_legacy_errors++;
+    }
+    if (TEST_EVENT == event_id) {
+        test_legacy_calls++;
+    } else if (TEST_PLAIN_EVENT == event_id) {
+        test_plain_shard = test_current_shard();
+    }
+    return SRV_STATUS_SUCCESS;
+}
+static void test_app_task(void *arg)
+{
+    memset(&app_context, 0, sizeof(app_context_t));
+    app_event_init();
+    app_event_register_callback(SRV_EVENT_ALL, test_legacy_callback);
+    xSemaphoreGive(test_ready);
+    app_event_shard_loop(0);
+}
+static void *test_producer(void *arg)
+{
+    uint32_t producer = (uint32_t)(uintptr_t)arg;
+    uint32_t seq;
+    for (seq = 0; seq < TEST_EVENT_NUM; seq++) {
+        while (SRV_STATUS_SUCCESS != app_event_post_with_key(TEST_EVENT, producer,
+                (void *)(uintptr_t)((producer << 24) | seq), NULL)) {
+            __atomic_fetch_add(&test_dropped, 1, __ATOMIC_RELAXED);
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+static void test_wait_idle(void)
+{
+    app_event_shard_stats_t stats;
+    uint32_t i;
+    uint32_t retry;
+    bool idle;
+    for (retry = 0; retry < 10000; retry++) {
+        idle = true;
+        for (i = 0; i < APP_EVENT_SHARD_NUM; i++) {
+            app_event_shard_get_stats(i, &stats);
+            if (stats.processed != stats.posted || 0 != uxQueueMessagesWaiting(app_context.shard[i].queue_handle)) {
+                idle = false;
+            }
+        }
+        if (idle) {
+            // the last event may still be in its callbacks
+            usleep(10000);
+            return;
+        }
+        usleep(1000);
+    }
+    printf("FAIL dispatchers did not drain\n");
+    test_failures++;
+}
+static void test_ordering_and_stats(void)
+{
+    pthread_t producer[TEST_PRODUCER_NUM];
+    app_event_shard_stats_t stats;
+    uint32_t expected[APP_EVENT_SHARD_NUM] = {0};
+    uint32_t posted = 0;
+    uint32_t dropped = 0;
+    uint32_t i;
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_event_register_shard_callback(SRV_EVENT_ALL, test_shard_callback));
+    for (i = 0; i < TEST_PRODUCER_NUM; i++) {
+        pthread_create(&producer[i], NULL, test_producer, (void *)(uintptr_t)i);
+        expected[i % APP_EVENT_SHARD_NUM] += TEST_EVENT_NUM;
+    }
+    for (i = 0; i < TEST_PRODUCER_NUM; i++) {
+        pthread_join(producer[i], NULL);
+    }
+    test_wait_idle();
+    TEST_CHECK(0 == test_order_errors);
+    TEST_CHECK(0 == test_shard_errors);
+    for (i = 0; i < TEST_PRODUCER_NUM; i++) {
+        TEST_CHECK(TEST_EVENT_NUM == test_next_seq[i]);
+    }
+    for (i = 0; i < APP_EVENT_SHARD_NUM; i++) {
+        TEST_CHECK(SRV_STATUS_SUCCESS == app_event_shard_get_stats(i, &stats));
+        TEST_CHECK(stats.posted == stats.processed);
+        TEST_CHECK(stats.posted == expected[i]);
+        TEST_CHECK(test_delivered[i] == expected[i]);
+        TEST_CHECK(stats.max_pending <= APP_QUEUE_SIZE);
+        posted += stats.posted;
+        dropped += stats.dropped;
+    }
+    TEST_CHECK(TEST_PRODUCER_NUM * TEST_EVENT_NUM == posted);
+    TEST_CHECK(test_dropped == dropped);
+    // legacy subscribers only see what reaches shard 0
+    TEST_CHECK(test_legacy_calls == test_delivered[0]);
+    TEST_CHECK(0 == test_legacy_errors);
+    TEST_CHECK(SRV_STATUS_INVALID_PARAM == app_event_shard_get_stats(APP_EVENT_SHARD_NUM, &stats));
+    printf("ordering: %u events, %u dropped and retried\n", posted, dropped);
+}
+static void test_plain_post(void)
+{
+    app_event_post(TEST_PLAIN_EVENT, NULL, NULL);
+    test_wait_idle();
+    TEST_CHECK(0 == test_plain_shard);
+}
+static void test_reject_from_dispatcher(void)
+{
+    if (APP_EVENT_SHARD_NUM < 2) {
+        return;
+    }
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_event_post_with_key(TEST_REJECT_EVENT, 1, NULL, NULL));
+    test_wait_idle();
+    TEST_CHECK(SRV_STATUS_INVALID_STATUS == test_reject_result);
+}
+static void test_deregister(void)
+{
+    uint32_t delivered[APP_EVENT_SHARD_NUM];
+    uint32_t i;
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_event_deregister_shard_callback(SRV_EVENT_ALL, test_shard_callback));
+    memcpy(delivered, test_delivered, sizeof(delivered));
+    // once deregister returned the callback must not run on any shard
+    for (i = 0; i < TEST_PRODUCER_NUM; i++) {
+        TEST_CHECK(SRV_STATUS_SUCCESS == app_event_post_with_key(TEST_EVENT, i, (void *)(uintptr_t)((i << 24) | TEST_EVENT_NUM), NULL));
+    }
+    test_wait_idle();
+    TEST_CHECK(0 == memcmp(delivered, test_delivered, sizeof(delivered)));
+}
+static void test_subscribe_without_queue(void)
+{
+    // app_event_init has not run, no shard has a queue to dispatch from
+    TEST_CHECK(SRV_STATUS_INVALID_STATUS == app_event_register_callback(SRV_EVENT_ALL, test_legacy_callback));
+    TEST_CHECK(SRV_STATUS_INVALID_STATUS == app_event_register_shard_callback(SRV_EVENT_ALL, test_shard_callback));
+    TEST_CHECK(SRV_STATUS_FAIL == app_event_post_with_key(TEST_EVENT, 0, NULL, NULL));
+}
+int main(void)
+{
+    test_subscribe_without_queue();
+    test_ready = xSemaphoreCreateBinary();
+    xTaskCreate(test_app_task, APP_TASK_NAME, APP_TASK_STACKSIZE, NULL, APP_TASK_PRIO, NULL);
+    xSemaphoreTake(test_ready, portMAX_DELAY);
+    test_ordering_and_stats();
+    test_plain_post();
+    test_reject_from_dispatcher();
+    test_deregister();
+    printf("test_app_event_shard (%d shards): %s\n", APP_EVENT_SHARD_NUM, test_failures ? "FAIL" : "PASS");
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include "app_main.h"
+#include "app_event.h"
+#include "app_key_gesture.h"
+
+#define TEST_RECORD_NUM (16)
+#define TEST_KEY        SRV_KEY_FUNC
+#define TEST_FILL_EVENT EVENT_APP_BATTERY_NOTIFICATION
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+typedef struct {
+    uint32_t time;
+    srv_key_value_t key_value;
+    srv_key_action_t key_action;
+} test_record_t;
+
+app_context_t app_context;
+
+static int test_failures;
+static test_record_t test_record[TEST_RECORD_NUM];
+static uint32_t test_record_num;
+
+static srv_status_t test_record_callback(srv_event_t event_id, void *parameters)
+{
+    app_ext_cmd_t *ext_cmd_p = (app_ext_cmd_t *)parameters;
+    if (test_record_num < TEST_RECORD_NUM) {
+        test_record[test_record_num].time = xTaskGetTickCount();
+        test_record[test_record_num].key_value = ext_cmd_p->key_value;
+        test_record[test_record_num].key_action = ext_cmd_p->key_action;
+    }
+    test_record_num++;
+    return SRV_STATUS_SUCCESS;
+}
+/* The test thread plays the app task, events are dispatched until the queue is empty. */
+static void test_pump(void)
+{
+    app_event_t event;
+    while (pdPASS == xQueueReceive(app_context.queue_handle, &event, 0)) {
+        app_event_process(&event);
+    }
+}
+static void test_run_until(uint32_t time)
+{
+    TimerHandle_t timer;
+    while (NULL != (timer = shim_timer_due(time))) {
+        shim_timer_fire(timer);
+        test_pump();
+    }
+    shim_tick = time;
+    test_pump();
+}
+static void test_edge(uint32_t time, bool pressed)
+{
+    test_run_until(time);
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge(TEST_KEY, pressed, time));
+    test_pump();
+}
+/* Occupy the app queue with events nobody handles, the next post fails. */
+static void test_fill_queue(void)
+{
+    while (SRV_STATUS_SUCCESS == app_event_post(TEST_FILL_EVENT, NULL, NULL)) {
+    }
+}
+static void test_setup(const char *name, uint32_t start)
+{
+    app_event_t event;
+    printf("%s\n", name);
+    while (pdPASS == xQueueReceive(app_context.queue_handle, &event, 0)) {
+    }
+    shim_timer_reset();
+    shim_timer_fail = 0;
+    shim_tick = start;
+    app_key_gesture_init();
+    memset(test_record, 0, sizeof(test_record));
+    test_record_num = 0;
+}
+static void test_expect(uint32_t index, uint32_t time, srv_key_action_t key_action)
+{
+    TEST_CHECK(index < test_record_num);
+    if (index < test_record_num) {
+        if (test_record[index].time != time || test_record[index].key_action != key_action
+                || test_record[index].key_value != TEST_KEY) {
+            printf("FAIL record %u: time %u action %d, expected time %u action %d\n", index,
+                   test_record[index].time, test_record[index].key_action, time, key_action);
+            test_failures++;
+        }
+    }
+}
+static void test_single_click(void)
+{
+    app_key_gesture_stats_t stats;
+    test_setup("single click", 0);
+    test_edge(100, true);
+    test_edge(200, false);
+    test_run_until(1000);
+    TEST_CHECK(2 == test_record_num);
+    test_expect(0, 100, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 200 + APP_KEY_GESTURE_MULTI_CLICK_TIME, SRV_KEY_ACT_PRESS_UP);
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_get_stats(TEST_KEY, &stats));
+    TEST_CHECK(2 == stats.emitted);
+    // the gap deadline is the reference, a timer on time gives no latency
+    TEST_CHECK(0 == stats.last_latency);
+    TEST_CHECK(0 == stats.max_latency);
+}
+static void test_double_click(void)
+{
+    test_setup("double click", 0);
+    test_edge(1000, true);
+    test_edge(1100, false);
+    test_edge(1200, true);
+    test_edge(1300, false);
+    test_run_until(2000);
+    TEST_CHECK(2 == test_record_num);
+    test_expect(0, 1000, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 1300 + APP_KEY_GESTURE_MULTI_CLICK_TIME, SRV_KEY_ACT_DOUBLE_CLICK);
+}
+static void test_triple_click(void)
+{
+    test_setup("triple click", 0);
+    test_edge(2000, true);
+    test_edge(2050, false);
+    test_edge(2100, true);
+    test_edge(2150, false);
+    test_edge(2200, true);
+    test_edge(2250, false);
+    // the last possible click is reported on release
+    TEST_CHECK(2 == test_record_num);
+    test_expect(0, 2000, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 2250, SRV_KEY_ACT_TRIPLE_CLICK);
+    test_run_until(3000);
+    TEST_CHECK(2 == test_record_num);
+}
+static void test_max_clicks_one(void)
+{
+    app_key_gesture_config_t config = {
+        APP_KEY_GESTURE_LONG_PRESS_TIME, APP_KEY_GESTURE_LONG_LONG_PRESS_TIME,
+        APP_KEY_GESTURE_VERY_LONG_PRESS_TIME, APP_KEY_GESTURE_MULTI_CLICK_TIME, 1
+    };
+    test_setup("max clicks one", 0);
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_set_config(TEST_KEY, &config));
+    test_edge(100, true);
+    test_edge(150, false);
+    TEST_CHECK(2 == test_record_num);
+    test_expect(0, 100, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 150, SRV_KEY_ACT_PRESS_UP);
+    // nothing left to wait for
+    TEST_CHECK(NULL == shim_timer_due(100000));
+}
+static void test_long_press_after_click(void)
+{
+    test_setup("long press after click", 0);
+    test_edge(100, true);
+    test_edge(200, false);
+    test_edge(300, true);
+    test_run_until(300 + APP_KEY_GESTURE_LONG_PRESS_TIME);
+    test_edge(2500, false);
+    TEST_CHECK(4 == test_record_num);
+    test_expect(0, 100, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 2300, SRV_KEY_ACT_PRESS_UP);
+    test_expect(2, 2300, SRV_KEY_ACT_LONG_PRESS_DOWN);
+    test_expect(3, 2500, SRV_KEY_ACT_LONG_PRESS_UP);
+}
+static void test_all_long_levels(void)
+{
+    test_setup("long press levels", 0);
+    test_edge(0, true);
+    test_run_until(12000);
+    test_edge(12000, false);
+    TEST_CHECK(5 == test_record_num);
+    test_expect(0, 0, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, APP_KEY_GESTURE_LONG_PRESS_TIME, SRV_KEY_ACT_LONG_PRESS_DOWN);
+    test_expect(2, APP_KEY_GESTURE_LONG_LONG_PRESS_TIME, SRV_KEY_ACT_LONG_LONG_PRESS_DOWN);
+    test_expect(3, APP_KEY_GESTURE_VERY_LONG_PRESS_TIME, SRV_KEY_ACT_VERY_LONG_PRESS_DOWN);
+    test_expect(4, 12000, SRV_KEY_ACT_VERY_LONG_PRESS_UP);
+}
+static void test_lost_release(void)
+{
+    test_setup("lost release", 0);
+    test_edge(100, true);
+    test_edge(150, true);
+    test_edge(250, false);
+    test_run_until(1000);
+    TEST_CHECK(2 == test_record_num);
+    test_expect(0, 100, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 250 + APP_KEY_GESTURE_MULTI_CLICK_TIME, SRV_KEY_ACT_PRESS_UP);
+}
+static void test_gap_expires_with_press(void)
+{
+    test_setup("gap expires with press", 0);
+    test_edge(100, true);
+    test_edge(200, false);
+    // the press lands at the gap deadline and is handled before the timer fires
+    shim_tick = 200 + APP_KEY_GESTURE_MULTI_CLICK_TIME;
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge(TEST_KEY, true, 200 + APP_KEY_GESTURE_MULTI_CLICK_TIME));
+    test_pump();
+    TEST_CHECK(3 == test_record_num);
+    test_expect(0, 100, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 500, SRV_KEY_ACT_PRESS_UP);
+    test_expect(2, 500, SRV_KEY_ACT_PRESS_DOWN);
+}
+static void test_timestamp_wrap(void)
+{
+    const uint32_t start = 0xffffff00;
+    test_setup("timestamp wrap", start);
+    test_edge(start, true);
+    test_run_until(start + APP_KEY_GESTURE_LONG_PRESS_TIME);
+    test_edge(start + 2100, false);
+    test_edge(0xfffffff0, true);
+    test_edge(0x00000010, false);
+    test_run_until(0x00001000);
+    TEST_CHECK(5 == test_record_num);
+    test_expect(0, start, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, start + APP_KEY_GESTURE_LONG_PRESS_TIME, SRV_KEY_ACT_LONG_PRESS_DOWN);
+    test_expect(2, start + 2100, SRV_KEY_ACT_LONG_PRESS_UP);
+    test_expect(3, 0xfffffff0, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(4, 0x00000010 + APP_KEY_GESTURE_MULTI_CLICK_TIME, SRV_KEY_ACT_PRESS_UP);
+}
+static void test_latency(void)
+{
+    app_key_gesture_stats_t stats;
+    TimerHandle_t timer;
+    test_setup("latency", 100);
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge_from_isr(TEST_KEY, true, 100));
+    // the app task gets to the edge 7 ms after the interrupt
+    shim_tick = 107;
+    test_pump();
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_get_stats(TEST_KEY, &stats));
+    TEST_CHECK(1 == stats.emitted);
+    TEST_CHECK(7 == stats.last_latency);
+    TEST_CHECK(7 == stats.max_latency);
+    shim_tick = 200;
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge_from_isr(TEST_KEY, false, 200));
+    test_pump();
+    // the gap timer runs 12 ms late
+    timer = shim_timer_due(200 + APP_KEY_GESTURE_MULTI_CLICK_TIME);
+    TEST_CHECK(NULL != timer);
+    if (NULL != timer) {
+        shim_tick = 200 + APP_KEY_GESTURE_MULTI_CLICK_TIME + 12;
+        shim_timer_fire(timer);
+        test_pump();
+    }
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_get_stats(TEST_KEY, &stats));
+    TEST_CHECK(2 == stats.emitted);
+    TEST_CHECK(12 == stats.last_latency);
+    TEST_CHECK(12 == stats.max_latency);
+    TEST_CHECK(0 == stats.dropped);
+    test_expect(1, 512, SRV_KEY_ACT_PRESS_UP);
+    TEST_CHECK(SRV_STATUS_INVALID_PARAM == app_key_gesture_get_stats(SRV_KEY_NONE, &stats));
+}
+static void test_single_wakeup(void)
+{
+    test_setup("single wakeup", 0);
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge(TEST_KEY, true, 0));
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge(TEST_KEY, false, 10));
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge_from_isr(TEST_KEY, true, 20));
+    TEST_CHECK(1 == uxQueueMessagesWaiting(app_context.queue_handle));
+    shim_tick = 20;
+    test_pump();
+    // all three edges were drained by the one wakeup, the press down is emitted at the pump
+    TEST_CHECK(1 == test_record_num);
+    test_expect(0, 20, SRV_KEY_ACT_PRESS_DOWN);
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge(TEST_KEY, false, 30));
+    TEST_CHECK(1 == uxQueueMessagesWaiting(app_context.queue_handle));
+    test_pump();
+}
+static void test_config_check(void)
+{
+    app_key_gesture_config_t config = {2000, 5000, 10000, 300, 3};
+    test_setup("config check", 0);
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_set_config(TEST_KEY, &config));
+    config.long_long_press_time = 2000;
+    TEST_CHECK(SRV_STATUS_INVALID_PARAM == app_key_gesture_set_config(TEST_KEY, &config));
+    config.long_long_press_time = 5000;
+    config.very_long_press_time = 4000;
+    TEST_CHECK(SRV_STATUS_INVALID_PARAM == app_key_gesture_set_config(TEST_KEY, &config));
+    config.long_long_press_time = 0;
+    config.very_long_press_time = 0;
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_set_config(TEST_KEY, &config));
+    config.max_clicks = 0;
+    TEST_CHECK(SRV_STATUS_INVALID_PARAM == app_key_gesture_set_config(TEST_KEY, &config));
+    config.max_clicks = APP_KEY_GESTURE_MAX_CLICKS + 1;
+    TEST_CHECK(SRV_STATUS_INVALID_PARAM == app_key_gesture_set_config(TEST_KEY, &config));
+    TEST_CHECK(SRV_STATUS_INVALID_PARAM == app_key_gesture_set_config(SRV_KEY_NONE, &config));
+}
+static void test_timer_retry(void)
+{
+    test_setup("timer retry", 0);
+    shim_timer_fail = 1;
+    test_edge(100, true);
+    // the failed arm is retried through the app queue
+    TEST_CHECK(0 == shim_timer_fail);
+    TEST_CHECK(NULL != shim_timer_due(100 + APP_KEY_GESTURE_LONG_PRESS_TIME));
+    test_run_until(100 + APP_KEY_GESTURE_LONG_PRESS_TIME);
+    TEST_CHECK(2 == test_record_num);
+    test_expect(1, 100 + APP_KEY_GESTURE_LONG_PRESS_TIME, SRV_KEY_ACT_LONG_PRESS_DOWN);
+}
+static void test_queue_full_deadline(void)
+{
+    TimerHandle_t timer;
+    test_setup("queue full deadline", 0);
+    test_edge(100, true);
+    test_fill_queue();
+    timer = shim_timer_due(100 + APP_KEY_GESTURE_LONG_PRESS_TIME);
+    TEST_CHECK(NULL != timer);
+    shim_timer_fire(timer);
+    // the wakeup post failed, the timer is armed again for the next tick
+    TEST_CHECK(NULL == shim_timer_due(100 + APP_KEY_GESTURE_LONG_PRESS_TIME));
+    TEST_CHECK(NULL != shim_timer_due(100 + APP_KEY_GESTURE_LONG_PRESS_TIME + 1));
+    test_pump();
+    test_run_until(6000);
+    TEST_CHECK(3 == test_record_num);
+    test_expect(0, 100, SRV_KEY_ACT_PRESS_DOWN);
+    test_expect(1, 100 + APP_KEY_GESTURE_LONG_PRESS_TIME + 1, SRV_KEY_ACT_LONG_PRESS_DOWN);
+    test_expect(2, 100 + APP_KEY_GESTURE_LONG_LONG_PRESS_TIME, SRV_KEY_ACT_LONG_LONG_PRESS_DOWN);
+}
+static void test_queue_full_edge(void)
+{
+    test_setup("queue full edge", 0);
+    test_edge(100, true);
+    test_fill_queue();
+    shim_tick = 200;
+    // accepted edges are picked up by the timer once the queue drains
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge(TEST_KEY, false, 200));
+    TEST_CHECK(NULL != shim_timer_due(201));
+    test_pump();
+    test_run_until(1000);
+    TEST_CHECK(2 == test_record_num);
+    test_expect(1, 200 + APP_KEY_GESTURE_MULTI_CLICK_TIME, SRV_KEY_ACT_PRESS_UP);
+
+    test_setup("queue full edge from isr", 0);
+    test_fill_queue();
+    shim_tick = 100;
+    TEST_CHECK(SRV_STATUS_SUCCESS == app_key_gesture_edge_from_isr(TEST_KEY, true, 100));
+    TEST_CHECK(NULL != shim_timer_due(101));
+    test_pump();
+    test_run_until(1000);
+    TEST_CHECK(1 == test_record_num);
+    test_expect(0, 101, SRV_KEY_ACT_PRESS_DOWN);
+
+    test_setup("queue full edge without timer", 0);
+    test_fill_queue();
+    shim_timer_fail = 2;
+    TEST_CHECK(SRV_STATUS_FAIL == app_key_gesture_edge(TEST_KEY, true, 0));
+    TEST_CHECK(SRV_STATUS_FAIL == app_key_gesture_edge_from_isr(TEST_KEY, false, 0));
+    TEST_CHECK(0 == shim_timer_fail);
+}
+int main(void)
+{
+    memset(&app_context, 0, sizeof(app_context_t));
+    app_event_init();
+    app_context.queue_handle = xQueueCreate(APP_QUEUE_SIZE, sizeof(app_event_t));
+    app_event_register_callback(EVENT_APP_KEY_GESTURE_WAKEUP, app_key_gesture_event_handler);
+    app_event_register_callback(EVENT_APP_EXT_COMMAND, test_record_callback);
+    test_single_click();
+    test_double_click();
+    test_triple_click();
+    test_max_clicks_one();
+    test_long_press_after_click();
+    test_all_long_levels();
+    test_lost_release();
+    test_gap_expires_with_press();
+    test_timestamp_wrap();
+    test_latency();
+    test_single_wakeup();
+    test_config_check();
+    test_timer_retry();
+    test_queue_full_deadline();
+    test_queue_full_edge();
+    printf("test_app_key_gesture: %s\n", test_failures ? "FAIL" : "PASS");
+    return test_failures ? 1 : 0;
+}